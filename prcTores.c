@@ -23,6 +23,8 @@
 //=       "Z" signifies states which are enforced sleep                     =
 //=    6) It assumed that the data starts at midnight (time = 0 minutes)    =
 //=    7) Ignore warnings on build                                          =
+//=    8) Tallies at end of run are saved in "name.res.ckp". When in.prc    =
+//=       has only grown since, the next run tallies just the new minutes   =
 //=-------------------------------------------------------------------------=
 //=  Build: bcc32 prcToRes.c                                                =
 //=-------------------------------------------------------------------------=
@@ -48,6 +50,22 @@
 #define MAX_SIZE 1000000           // Maximum size of input data in minutes
 #define NUMPARAMETERS  2           // Numer of parameters used
 #define PRICEPERKWH 0.08           // Dollar Price of each KWh consumed
+#define HASH_OFFSET 2166136261UL   // FNV-1a hash initial value
+#define HASH_PRIME    16777619UL   // FNV-1a hash multiplier
+#define CHECKPOINT_VERSION 2       // Format of checkpoint files
+#define TAIL_WINDOW ONEDAY         // Minutes of previous input checked
+
+typedef struct TallyCheckpoint {
+    int           length;          // Minutes already tallied
+    unsigned long hash;            // Hash of parameters and the last
+                                   // TAIL_WINDOW of those minutes
+    int           sleepTime;       // Enforced sleep time so far
+    int           wakeUpCount;     // Forced wake-ups so far
+    int           AoffTime;        // Minutes already off so far
+    int           AsleepTime;      // Minutes already asleep so far
+    int           idleState;       // Flag for idle state after last minute
+
+} Checkpoint;
 
 //----- Globals -------------------------------------------------------------
 char X[MAX_SIZE];                  // Time series read from "in.prc"
@@ -58,15 +76,26 @@ int  AsleepTime;                   // Total mintues computers already sleep
 
 //----- Prototypes ----------------------------------------------------------
 // Function to load X[] and determine N
-void loadX(void);
+void loadX(int start);
 // Compute sleep time
-void computeSleep(int *sleepTime, int *wakeUpCount); 
+void computeSleep(int start, int *sleepTime, int *wakeUpCount, int *idleState);
 // Computes wattage Savings in percent
 double computeSavingsPercent(int sleepTime, int sleepWatts, int activeWatts); 
 // Computes wattage Savings in watts
 double computeSavingsWatts(int sleepTime, int sleepWatts, int activeWatts);
 //Sets parameters
 void getParameters(char* line, float **parameters, char *outFileName);
+// Continue a hash over length bytes
+unsigned long hashBytes(unsigned long hash, char *bytes, int length);
+// Read checkpoint of a previous run, returns FALSE if there is none
+int readCheckpoint(char *fileName, Checkpoint *checkpoint);
+// Save checkpoint for the next run
+void writeCheckpoint(char *fileName, Checkpoint *checkpoint);
+// Load minutes appended since a previous run, checking the ones before
+int loadAppended(long dataStart, int length, unsigned long startHash,
+                 unsigned long hash);
+// Continue a hash over the last minutes of X
+unsigned long hashTail(unsigned long hash);
 
 //===========================================================================
 //=  Main program                                                           =
@@ -75,20 +104,23 @@ int main(int argc, char *argv[])
 {
   float    *parameters[NUMPARAMETERS]; // Array of parameters
   int      idleState;                  // Flag for idle state
-  int      idleCount;                  // Counter for idle state
   int      wakeUpCount;                // Counter for wake-up events
   int      sleepTime;                  // Total sleep time
   float    activeWatts;                // Consumption while on 
   float    sleepWatts;                 // Consumption while sleep 
+  int      start;                      // First minute not tallied before
+  Checkpoint checkpoint;               // Tallies saved between runs
+  unsigned long configHash;            // Hash of parameters
+  unsigned long inputHash;             // Hash of configHash and input tail
+  long     dataStart;                  // Offset of first minute in in.prc
 
   char     dataFile[255];              // Name of in.prc file
   char     outFileName[255];           // Name of .res file
+  char     checkpointFileName[260];    // Name of .res.ckp file
   char     computerName[250];          // Name of computer used for outputFile
   char     params[128];                // Parameters from first line of file
   FILE     *procFile;                  // .prc file
 
-  int      i;                          // Loop counter
-
   // Initialize default values
 
   activeWatts = 100;    // 100 Watts active consumption
@@ -116,6 +148,11 @@ int main(int argc, char *argv[])
 
   //Read first line of in.prc file for parameters and set them accordingly
   fgets(params, 128, InFile);
+  dataStart = ftell(InFile);
+
+  // Checkpoint is only valid for same format and parameters
+  configHash = (HASH_OFFSET ^ CHECKPOINT_VERSION) * HASH_PRIME;
+  configHash = hashBytes(configHash, params, strlen(params));
   getParameters(params, parameters, outFileName);
 
   //Get the name of the computer and open a new file (name.res) for writing
@@ -123,6 +160,8 @@ int main(int argc, char *argv[])
 
   //Add file extension
   strncat(outFileName,".res",5);
+  strncpy(checkpointFileName,outFileName,255);
+  strncat(checkpointFileName,".ckp",5);
 
   //Open file for write
   procFile = fopen(outFileName,"w");
@@ -132,11 +171,37 @@ int main(int argc, char *argv[])
     return -1;
   }
 
-  // Load X and determine N
-  loadX();
+  // Continue tallies of previous run if in.prc only grew since. Then only
+  // the appended minutes need to be loaded.
+  if ((readCheckpoint(checkpointFileName, &checkpoint) == TRUE) &&
+      (checkpoint.length >= 0) &&
+      (loadAppended(dataStart, checkpoint.length, configHash,
+                    checkpoint.hash) == TRUE))
+  {
+    start       = checkpoint.length;
+    sleepTime   = checkpoint.sleepTime;
+    wakeUpCount = checkpoint.wakeUpCount;
+    AoffTime    = checkpoint.AoffTime;
+    AsleepTime  = checkpoint.AsleepTime;
+    idleState   = checkpoint.idleState;
+  }
+  else
+  {
+    // Load X from the start and determine N
+    fseek(InFile, dataStart, SEEK_SET);
+    loadX(0);
+
+    start       = 0;
+    sleepTime   = 0;
+    wakeUpCount = 0;
+    AoffTime    = 0;
+    AsleepTime  = 0;
+    idleState   = TRUE;
+  }
+  inputHash = hashTail(configHash);
 
   // Determine total sleep time and number of forced wake-ups
-  computeSleep(&sleepTime, &wakeUpCount);
+  computeSleep(start, &sleepTime, &wakeUpCount, &idleState);
 
   //-----------Output to .res file-------------------------------------------
   //Name of computer
@@ -158,19 +223,29 @@ int main(int argc, char *argv[])
 
   //close file pointers
   fclose(procFile);
+
+  // Save tallies for the next run
+  checkpoint.length      = N;
+  checkpoint.hash        = inputHash;
+  checkpoint.sleepTime   = sleepTime;
+  checkpoint.wakeUpCount = wakeUpCount;
+  checkpoint.AoffTime    = AoffTime;
+  checkpoint.AsleepTime  = AsleepTime;
+  checkpoint.idleState   = idleState;
+  writeCheckpoint(checkpointFileName, &checkpoint);
   return 0;
 }
 
 //---------------------------------------------------------------------------
-//-  Load X and determine N                                                 -
+//-  Load X from X[start] on and determine N                                -
 //---------------------------------------------------------------------------
-void loadX()
+void loadX(int start)
 {
   char     value;                  // Value read-in
   int      i;                      // Loop counter
 
   // Load the series X and determine N
-  i = 0;
+  i = start;
   while(1)
   {
     value = fgetc(InFile);
@@ -184,19 +259,17 @@ void loadX()
 }
 
 //---------------------------------------------------------------------------
-//-  Determine total sleep time and number of forced wake-ups               -
+//-  Determine total sleep time and number of forced wake-ups, adding the   -
+//-  tallies from X[start] on to those passed in                            -
 //---------------------------------------------------------------------------
-void computeSleep(int *sleepTime, int *wakeUpCount)
+void computeSleep(int start, int *sleepTime, int *wakeUpCount, int *idleState)
 {
-  int      idleState;              // Flag for idle state
   int      i;                      // Loop counter
 
   //NOTE!!!
   //Forced wakeups are {Z,S,O}->{I,A,U} 
  // Loop to determine total sleep time and number of forced wake-ups
-  *sleepTime = *wakeUpCount = 0;
-  idleState = TRUE;
-  for (i=0; i<N; i++)
+  for (i=start; i<N; i++)
   {
     // Determine total time Computer was already asleep or off
     if (X[i] == 'S')
@@ -206,9 +279,9 @@ void computeSleep(int *sleepTime, int *wakeUpCount)
       ++AoffTime;
 
     // Determine if start of next busy period
-    if (((X[i] == 'A') || (X[i] == 'U') || (X[i] == 'I')) && (idleState == TRUE))
+    if (((X[i] == 'A') || (X[i] == 'U') || (X[i] == 'I')) && (*idleState == TRUE))
     {
-      idleState = FALSE;
+      *idleState = FALSE;
       *wakeUpCount = *wakeUpCount + 1;
     }
 
@@ -216,7 +289,7 @@ void computeSleep(int *sleepTime, int *wakeUpCount)
     if ((X[i] == 'S') ||
         (X[i] == 'Z') ||
         (X[i] == 'O'))
-      idleState = TRUE;
+      *idleState = TRUE;
 
     // Tally the sleep
     if (X[i] == 'Z')
@@ -303,3 +376,122 @@ void getParameters(char* line, float **parameters, char *outFileName)
      tokenHolder = strtok(NULL,tokens);
   }
 }
+
+//---------------------------------------------------------------------------
+//-  Continue FNV-1a hash over length bytes                                 -
+//---------------------------------------------------------------------------
+unsigned long hashBytes(unsigned long hash, char *bytes, int length)
+{
+  int      i;                      // Loop counter
+
+  for (i=0; i<length; i++)
+    hash = (hash ^ (unsigned char) bytes[i]) * HASH_PRIME;
+
+  return hash;
+}
+
+//---------------------------------------------------------------------------
+//-  Read checkpoint of a previous run. Returns FALSE if there is none.     -
+//---------------------------------------------------------------------------
+int readCheckpoint(char *fileName, Checkpoint *checkpoint)
+{
+  FILE     *checkpointFile;        // .res.ckp file
+  int      count;                  // Number of values read
+
+  checkpointFile = fopen(fileName,"r");
+  if(checkpointFile == NULL)
+    return FALSE;
+
+  count = fscanf(checkpointFile,"%d,%lu,%d,%d,%d,%d,%d",
+    &checkpoint->length, &checkpoint->hash,
+    &checkpoint->sleepTime, &checkpoint->wakeUpCount,
+    &checkpoint->AoffTime, &checkpoint->AsleepTime,
+    &checkpoint->idleState);
+  fclose(checkpointFile);
+
+  if (count != 7)
+  {
+    printf("*** WARNING - Ignoring malformed checkpoint %s\n", fileName);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+//---------------------------------------------------------------------------
+//-  Save checkpoint for the next run                                       -
+//---------------------------------------------------------------------------
+void writeCheckpoint(char *fileName, Checkpoint *checkpoint)
+{
+  FILE     *checkpointFile;        // .res.ckp file
+  char     tempFileName[265];      // Checkpoint being written
+  int      failed;                 // TRUE if writing checkpoint failed
+
+  // Write to a temporary file first so a half-written checkpoint is never
+  // read back as valid
+  strncpy(tempFileName,fileName,260);
+  strncat(tempFileName,".tmp",5);
+
+  checkpointFile = fopen(tempFileName,"w");
+  if(checkpointFile == NULL)
+  {
+    fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", tempFileName);
+    return;
+  }
+
+  fprintf(checkpointFile,"%d,%lu,%d,%d,%d,%d,%d\n",
+    checkpoint->length, checkpoint->hash,
+    checkpoint->sleepTime, checkpoint->wakeUpCount,
+    checkpoint->AoffTime, checkpoint->AsleepTime,
+    checkpoint->idleState);
+  // Don't replace old checkpoint with one that failed to write
+  failed = (ferror(checkpointFile) != 0);
+  if (fclose(checkpointFile) != 0)
+    failed = TRUE;
+  if (failed == TRUE)
+  {
+    fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", tempFileName);
+    remove(tempFileName);
+    return;
+  }
+
+  // Move into place, removing the old checkpoint where rename() won't
+  if (rename(tempFileName, fileName) != 0)
+  {
+    remove(fileName);
+    if (rename(tempFileName, fileName) != 0)
+      fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", fileName);
+  }
+}
+
+//---------------------------------------------------------------------------
+//-  Load X from X[length - window] on, where window is the last TAIL_WINDOW-
+//-  minutes of a previous input of length minutes. Returns TRUE if those   -
+//-  minutes still hash to hash, i.e. input only had minutes appended.      -
+//---------------------------------------------------------------------------
+int loadAppended(long dataStart, int length, unsigned long startHash,
+                 unsigned long hash)
+{
+  int      window;                 // Minutes checked before length
+
+  window = (length < TAIL_WINDOW) ? length : TAIL_WINDOW;
+  if (fseek(InFile, dataStart + length - window, SEEK_SET) != 0)
+    return FALSE;
+
+  loadX(length - window);
+
+  return (N >= length) &&
+         (hashBytes(startHash, &X[length - window], window) == hash);
+}
+
+//---------------------------------------------------------------------------
+//-  Continue hash over last TAIL_WINDOW minutes of X                       -
+//---------------------------------------------------------------------------
+unsigned long hashTail(unsigned long hash)
+{
+  int      window;                 // Minutes hashed
+
+  window = (N < TAIL_WINDOW) ? N : TAIL_WINDOW;
+
+  return hashBytes(hash, &X[N - window], window);
+}
@@ -31,6 +31,10 @@
 //=   10) Must initialize wakeUpTime to time that the computer should be    =
 //=       woken up by magic packet. Set to -1 to prevent wake up            =
 //=   11) Ignore warnings on build                                          =
+//=   12) State at end of run is saved in "name.prc.ckp". When in.vec has   =
+//=       only grown since, the next run simulates just the new minutes and =
+//=       appends them to "name.prc". Changing a policy forces a full run,  =
+//=       which also removes "name.res.ckp" of prcTores                     =
 //=-------------------------------------------------------------------------=
 //=  Build: bcc32 sleepSim3.c                                               =
 //=-------------------------------------------------------------------------=
@@ -56,6 +60,12 @@
 #define   ONEDAY    1440           // Number of minutes in one day
 #define MAX_SIZE 1000000           // Maximum size of input data in minutes
 #define NUMPARAMETERS  2           // Numer of parameters used
+#define MAX_MEMOS    128           // Maximum number of distinct days memoized
+#define MEMO_BUCKETS 1031          // Number of buckets in day memo table
+#define HASH_OFFSET 2166136261UL   // FNV-1a hash initial value
+#define HASH_PRIME    16777619UL   // FNV-1a hash multiplier
+#define CHECKPOINT_VERSION 2       // Format of checkpoint files
+#define TAIL_WINDOW ONEDAY         // Minutes of previous input checked
 
 typedef struct PowerPolicy {
     int timeOut1;                  // First timeout value
@@ -68,22 +78,83 @@ typedef struct PowerPolicy {
 
 } Policy;
 
+typedef struct SimulationState {
+    int idleState;                 // Flag for idle state
+    int idleCount;                 // Counter for idle state
+    int timeOutCurrent;            // Current timeout value
+
+} State;
+
+typedef struct DayMemo {
+    unsigned long hash;            // Hash of day contents and entry state
+    Policy        policy;          // Policy the day was simulated under
+    int           prevSleep;       // TRUE if minute before day was 'Z'
+    State         entry;           // State when entering the day
+    State         exit;            // State when leaving the day
+    char          in[ONEDAY];      // Day before simulation
+    char          out[ONEDAY];     // Day after simulation
+    int           next;            // Next memo in bucket, -1 if none
+
+} Memo;
+
+typedef struct SimulationCheckpoint {
+    int           length;          // Minutes already simulated
+    unsigned long hash;            // Hash of policies, parameters and the
+                                   // last TAIL_WINDOW of those minutes
+    State         state;           // State after last simulated minute
+    int           dayCounter;      // Day of week of last simulated minute
+    char          lastMinute;      // Output of last simulated minute
+    int           pendingWakeUp;   // Rest of wake up window past last minute
+
+} Checkpoint;
+
 //----- Globals -------------------------------------------------------------
 char X[MAX_SIZE];                  // Time series read from "in.vec"
 int  N;                            // Number of values in "in.vec"
 FILE *InFile;                      // "in.vec" file
 int  AoffTime;                     // Total minutes computers already off
 int  AsleepTime;                   // Total mintues computers already sleep
+Memo Memos[MAX_MEMOS];             // Outcomes of already simulated days
+int  NumMemos;                     // Number of entries used in Memos[]
+int  MemoBucket[MEMO_BUCKETS];     // First memo in each bucket, -1 if none
+int  PendingWakeUp;                // Rest of last wake up window past X[N-1]
 
 //----- Prototypes ----------------------------------------------------------
 // Function to load X[] and determine N
-void loadX(void);
+void loadX(int start);
 // Output X vector
-void outputX(FILE *outPutFile);
+void outputX(FILE *outPutFile, int start);
 // Sets parameters
 void getParameters(char* line, float **parameters, char *outFileName);
 // Wakes up from poweroff by use of Magic Packet
 void wakeUpDevice(int position, int timeOut);
+// Simulates X[start] to X[end - 1], all within one day
+int simulateDay(int start, int end, Policy *policy, State *state);
+// Continue a hash over length bytes
+unsigned long hashBytes(unsigned long hash, char *bytes, int length);
+// Check two policies have the same values
+int samePolicy(Policy *policy1, Policy *policy2);
+// Continue a hash over the values of a policy
+unsigned long hashPolicy(unsigned long hash, Policy *policy);
+// Hash a day along with its entry state
+unsigned long hashDay(int start, Policy *policy, int prevSleep, State *state);
+// Look up the outcome of an identical day simulated before
+Memo* findMemo(unsigned long hash, int start, Policy *policy, int prevSleep,
+               State *state);
+// Record the outcome of a simulated day
+void addMemo(unsigned long hash, char *in, int start, Policy *policy,
+             int prevSleep, State *entry, State *exit);
+// Read checkpoint of a previous run, returns FALSE if there is none
+int readCheckpoint(char *fileName, Checkpoint *checkpoint);
+// Save checkpoint for the next run
+void writeCheckpoint(char *fileName, Checkpoint *checkpoint);
+// Check output of a previous run holds exactly length minutes
+int checkOutput(char *fileName, int length);
+// Load minutes appended since a previous run, checking the ones before
+int loadAppended(long dataStart, int length, unsigned long startHash,
+                 unsigned long hash);
+// Continue a hash over the last minutes of X
+unsigned long hashTail(unsigned long hash);
 
 //===========================================================================
 //=  Main program                                                           =
@@ -96,11 +167,20 @@ int main(int argc, char *argv[])
   Policy   weekEndPolicy;              // Power policy for weekends
   Policy*  activePolicy;               // Active policy for main loop
 
-  int      timeOutCurrent;             // Current timeout value
-  int      dailyTime;                  // Time from last midnight
+  State    state;                      // Simulation state between minutes
+  State    entry;                      // Simulation state entering a day
+  Memo*    memo;                       // Memoized outcome of current day
+  unsigned long hash;                  // Hash of current day
+  char     dayIn[ONEDAY];              // Current day before simulation
+  int      prevSleep;                  // TRUE if minute before day was 'Z'
+  int      dayEnd;                     // End of current day or of input
   int      dayCounter;                 // Days simulation has run for
-  int      idleState;                  // Flag for idle state
-  int      idleCount;                  // Counter for idle state
+  int      start;                      // First minute not simulated before
+  int      resume;                     // TRUE if continuing a previous run
+  Checkpoint checkpoint;               // State saved between runs
+  unsigned long configHash;            // Hash of policies and parameters
+  unsigned long inputHash;             // Hash of configHash and input tail
+  long     dataStart;                  // Offset of first minute in in.vec
   int      wakeUpCount;                // Counter for wake-up events
   int      sleepTime;                  // Total sleep time
   float    activeWatts;                // Consumption while on 
@@ -108,6 +188,8 @@ int main(int argc, char *argv[])
 
   char     dataFile[255];              // Name of in.vec file
   char     outFileName[255];           // Name of .prcfile
+  char     checkpointFileName[260];    // Name of .prc.ckp file
+  char     resCheckpointFileName[260]; // Name of .res.ckp file of prcTores
   char     computerName[250];          // Name of computer used for outputFile
   char     params[128];                // Parameters from first line of file
   FILE     *procFile;                  // .prc file
@@ -155,6 +237,13 @@ int main(int argc, char *argv[])
 
   //Read first line of file for parameters and set accordingly
   fgets(params, 128, InFile);
+  dataStart = ftell(InFile);
+
+  // Checkpoint is only valid for same format, policies and parameters
+  configHash = (HASH_OFFSET ^ CHECKPOINT_VERSION) * HASH_PRIME;
+  configHash = hashPolicy(configHash, &weekDayPolicy);
+  configHash = hashPolicy(configHash, &weekEndPolicy);
+  configHash = hashBytes(configHash, params, strlen(params));
   getParameters(params, parameters, outFileName);
 
   //Get the name of the computer and open a new file (name.res) for writing
@@ -162,33 +251,77 @@ int main(int argc, char *argv[])
 
   //Add file extension
   strncat(outFileName,".prc",5);
-  
+  strncpy(checkpointFileName,outFileName,255);
+  strncat(checkpointFileName,".ckp",5);
+  strncpy(resCheckpointFileName,computerName,250);
+  strncat(resCheckpointFileName,".res.ckp",9);
+
+  // Continue previous run if in.vec only had minutes appended since, and
+  // its output holds exactly the minutes simulated so far. Then only the
+  // appended minutes need to be loaded.
+  resume = FALSE;
+  if ((readCheckpoint(checkpointFileName, &checkpoint) == TRUE) &&
+      (checkpoint.length > 0) &&
+      (checkOutput(outFileName, checkpoint.length) == TRUE) &&
+      (loadAppended(dataStart, checkpoint.length, configHash,
+                    checkpoint.hash) == TRUE))
+    resume = TRUE;
+
+  // Otherwise load X from the start and determine N
+  if (resume == FALSE)
+  {
+    fseek(InFile, dataStart, SEEK_SET);
+    loadX(0);
+
+    // name.prc is rewritten, so tallies prcTores saved from it are stale
+    remove(resCheckpointFileName);
+  }
+  inputHash = hashTail(configHash);
+
   //Open file for write
-  procFile = fopen(outFileName,"w");
+  procFile = fopen(outFileName, (resume == TRUE) ? "a" : "w");
   if(procFile == NULL)
   {
     fprintf(stdout, "*** ERROR - \tCannot write to file %s\n" ,outFileName );
     return -1;
   }
 
-  // Load X and determine N
-  loadX();
-
   // Start at a weekday
   activePolicy = &weekDayPolicy;
 
-  // Will be incremented to 0 in beginning of simulation loop
-  dayCounter = -1;
+  // No days have been simulated yet
+  NumMemos = 0;
+  for (i=0; i<MEMO_BUCKETS; i++)
+    MemoBucket[i] = -1;
+
+  if (resume == TRUE)
+  {
+    // Pick up where previous run stopped
+    start = checkpoint.length;
+    state = checkpoint.state;
+    dayCounter = checkpoint.dayCounter;
+    X[start-1] = checkpoint.lastMinute;
+
+    // Finish wake up window that ran past end of previous input
+    wakeUpDevice(start, checkpoint.pendingWakeUp);
+  }
+  else
+  {
+    // Will be incremented to 0 in beginning of simulation loop
+    start = 0;
+    dayCounter = -1;
+    state.idleState = FALSE;
+    state.idleCount = 0;
+    state.timeOutCurrent = 0;
+    PendingWakeUp = 0;
+  }
 
   // ****************** Main simulation loop ****************
-  idleState = FALSE;
-  idleCount = 0;
-  for (i=0; i<N; i++)
+  for (i=start; i<N; i=dayEnd)
   {
-    // Set dailyTime to zero when cross midnight
-    if ((i % ONEDAY) == 0) 
+    // Advance day of week when cross midnight
+    if ((i % ONEDAY) == 0)
     {
-      dailyTime = 0;
       dayCounter ++;
       dayCounter = dayCounter %7;
       printf("%d, ",dayCounter);
@@ -206,79 +339,71 @@ int main(int argc, char *argv[])
       activePolicy = &weekDayPolicy;
     }
 
-    // Determine if start of next idle period
-    if ((X[i] == 'I')  && (idleState == FALSE))
-      idleState = TRUE;
+    // Simulate up to next midnight or end of input
+    dayEnd = (i / ONEDAY + 1) * ONEDAY;
+    if (dayEnd > N)
+      dayEnd = N;
 
-    // Determine if start of next busy period
-    if ((X[i] == 'A') || (X[i]  == 'U') || (X[i] == 'O') || (X[i] == 'S'))
+    // Only whole days are memoized
+    if (dayEnd - i != ONEDAY)
     {
-      idleState = FALSE;
-      idleCount = 0;
+      simulateDay(i, dayEnd, activePolicy, &state);
+      continue;
     }
 
-    // Execute the timeout while in an idle period
-    if (idleState == TRUE)
+    // Reuse outcome of an identical day if one has been simulated
+    prevSleep = (i > 0) && (X[i-1] == 'Z');
+    hash = hashDay(i, activePolicy, prevSleep, &state);
+    memo = findMemo(hash, i, activePolicy, prevSleep, &state);
+    if (memo != NULL)
     {
-      if ((dailyTime <= activePolicy->time1) || (dailyTime > activePolicy->time2))
-       timeOutCurrent = activePolicy->timeOut1;
-      else
-       timeOutCurrent = activePolicy->timeOut2;
-
-      
-      //set timeout for the next policy
-      if ((dailyTime == activePolicy->time2 + 1) || (dailyTime == activePolicy->time1 + 1))
-      {
-        // Stay asleep if already been asleep
-        if (X[i-1] == 'Z')
-          idleCount = timeOutCurrent;
-        else //If computer wasn't in a forced sleep keep it awake
-            idleCount = 0;
-      }
-
-
-      // Put computer to sleep if timout has been triggered
-      if (idleCount >= timeOutCurrent)
-        X[i] = 'Z';
-      else
-        idleCount++;
-    }
-
-    //Wake up at beginning of the day
-    if (dailyTime == activePolicy->wakeUpTime)
-    {
-      idleState  = FALSE;
-      idleCount  = 0;
-      wakeUpDevice(i,timeOutCurrent);
+      memcpy(&X[i], memo->out, ONEDAY);
+      state = memo->exit;
+      continue;
     }
 
-    // Increment dailyTime
-    dailyTime++;
+    // Simulate the day and remember its outcome
+    memcpy(dayIn, &X[i], ONEDAY);
+    entry = state;
+    if (simulateDay(i, dayEnd, activePolicy, &state) == TRUE)
+      addMemo(hash, dayIn, i, activePolicy, prevSleep, &entry, &state);
   }
 
-  //Include parameter line in procFile
-  fprintf(procFile,"%s,",computerName);
-  fprintf(procFile,"%f,",*parameters[0]);
-  fprintf(procFile,"%f\n",*parameters[1]);
+  //Include parameter line in procFile, already there when appending
+  if (resume == FALSE)
+  {
+    fprintf(procFile,"%s,",computerName);
+    fprintf(procFile,"%f,",*parameters[0]);
+    fprintf(procFile,"%f\n",*parameters[1]);
+  }
 
   // Output input vector
-  outputX(procFile);
+  outputX(procFile, start);
 
   //close file pointers
   fclose(procFile);
+
+  // Save state for the next run
+  checkpoint.length        = N;
+  checkpoint.hash          = inputHash;
+  checkpoint.state         = state;
+  checkpoint.dayCounter    = dayCounter;
+  checkpoint.lastMinute    = (N > 0) ? X[N-1] : 'U';
+  checkpoint.pendingWakeUp = PendingWakeUp;
+  writeCheckpoint(checkpointFileName, &checkpoint);
   return 0;
 }
 
 //---------------------------------------------------------------------------
-//-  Load X and determine N                                                 -
+//-  Load X from X[start] on and determine N                                -
 //---------------------------------------------------------------------------
-void loadX()
+void loadX(int start)
 {
   char     value;                  // Value read-in
   int      i;                      // Loop counter
 
   // Load the series X and determine N
-  i = 0;
+  i = start;
   while(1)
   {
     value = fgetc(InFile);
@@ -306,13 +431,13 @@ void loadX()
 }
 
 //---------------------------------------------------------------------------
-//-  Output X vector                                                        -
+//-  Output X vector from X[start] on                                      -
 //---------------------------------------------------------------------------
-void outputX(FILE *outPutFile)
+void outputX(FILE *outPutFile, int start)
 {
   int      i;                      // Loop counter
 
-  for (i=0; i<N; i++)
+  for (i=start; i<N; i++)
     fprintf(outPutFile,"%c", X[i]);
 }
 
@@ -362,8 +487,16 @@ void wakeUpDevice(int position, int timeOut)
   int      i;                      // Loop counter
 
   //loop to turn pc on if it was already off for the duration of timeOut - 1
+  PendingWakeUp = 0;
   for(i = 0; i < timeOut; ++i)
   {
+    //Rest of window is past end of input, finish it in the next run
+    if( position + i >= N )
+    {
+      PendingWakeUp = timeOut - i;
+      break;
+    }
+
     //Check if the PC is asleep
     if( X[position + i] == 'Z' || X[position + i] == 'S' )
     {
@@ -374,3 +507,329 @@ void wakeUpDevice(int position, int timeOut)
   }
 }
 
+
+//---------------------------------------------------------------------------
+//-  Simulate X[start] to X[end - 1] under policy, all within one day.      -
+//-  Returns FALSE if a wake up reached past end, so day can't be memoized  -
+//---------------------------------------------------------------------------
+int simulateDay(int start, int end, Policy *policy, State *state)
+{
+  int      dailyTime;              // Time from last midnight
+  int      memoizable;             // Day touched only X[start] to X[end-1]
+  int      i;                      // Loop counter
+
+  memoizable = TRUE;
+  for (i=start; i<end; i++)
+  {
+    dailyTime = i % ONEDAY;
+
+    // Determine if start of next idle period
+    if ((X[i] == 'I')  && (state->idleState == FALSE))
+      state->idleState = TRUE;
+
+    // Determine if start of next busy period
+    if ((X[i] == 'A') || (X[i]  == 'U') || (X[i] == 'O') || (X[i] == 'S'))
+    {
+      state->idleState = FALSE;
+      state->idleCount = 0;
+    }
+
+    // Execute the timeout while in an idle period
+    if (state->idleState == TRUE)
+    {
+      if ((dailyTime <= policy->time1) || (dailyTime > policy->time2))
+       state->timeOutCurrent = policy->timeOut1;
+      else
+       state->timeOutCurrent = policy->timeOut2;
+
+
+      //set timeout for the next policy
+      if ((dailyTime == policy->time2 + 1) || (dailyTime == policy->time1 + 1))
+      {
+        // Stay asleep if already been asleep
+        if (X[i-1] == 'Z')
+          state->idleCount = state->timeOutCurrent;
+        else //If computer wasn't in a forced sleep keep it awake
+            state->idleCount = 0;
+      }
+
+
+      // Put computer to sleep if timout has been triggered
+      if (state->idleCount >= state->timeOutCurrent)
+        X[i] = 'Z';
+      else
+        state->idleCount++;
+    }
+
+    //Wake up at beginning of the day
+    if (dailyTime == policy->wakeUpTime)
+    {
+      state->idleState  = FALSE;
+      state->idleCount  = 0;
+      wakeUpDevice(i,state->timeOutCurrent);
+      if (i + state->timeOutCurrent > end)
+        memoizable = FALSE;
+    }
+  }
+
+  return memoizable;
+}
+
+//---------------------------------------------------------------------------
+//-  Continue FNV-1a hash over length bytes                                 -
+//---------------------------------------------------------------------------
+unsigned long hashBytes(unsigned long hash, char *bytes, int length)
+{
+  int      i;                      // Loop counter
+
+  for (i=0; i<length; i++)
+    hash = (hash ^ (unsigned char) bytes[i]) * HASH_PRIME;
+
+  return hash;
+}
+
+//---------------------------------------------------------------------------
+//-  Check two policies have the same values                               -
+//---------------------------------------------------------------------------
+int samePolicy(Policy *policy1, Policy *policy2)
+{
+  return (policy1->timeOut1   == policy2->timeOut1) &&
+         (policy1->timeOut2   == policy2->timeOut2) &&
+         (policy1->time1      == policy2->time1) &&
+         (policy1->time2      == policy2->time2) &&
+         (policy1->wakeUpTime == policy2->wakeUpTime);
+}
+
+//---------------------------------------------------------------------------
+//-  Continue hash over the values of policy                                -
+//---------------------------------------------------------------------------
+unsigned long hashPolicy(unsigned long hash, Policy *policy)
+{
+  hash = (hash ^ (unsigned long) policy->timeOut1) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) policy->timeOut2) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) policy->time1) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) policy->time2) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) policy->wakeUpTime) * HASH_PRIME;
+
+  return hash;
+}
+
+//---------------------------------------------------------------------------
+//-  Hash of day starting at X[start] along with its entry state. The day   -
+//-  is hashed a word at a time, byte at a time costs as much as simulating -
+//-  it. Policy is hashed by value so memos don't depend on this process.   -
+//---------------------------------------------------------------------------
+unsigned long hashDay(int start, Policy *policy, int prevSleep, State *state)
+{
+  unsigned long hash;              // Running hash value
+  unsigned long word;              // Next sizeof(unsigned long) minutes
+  int      i;                      // Loop counter
+
+  // ONEDAY is a multiple of sizeof(unsigned long)
+  hash = HASH_OFFSET;
+  for (i=start; i<start+ONEDAY; i+=sizeof(unsigned long))
+  {
+    memcpy(&word, &X[i], sizeof(unsigned long));
+    hash = (hash ^ word) * HASH_PRIME;
+  }
+
+  hash = (hash ^ (unsigned long) state->idleState) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) state->idleCount) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) state->timeOutCurrent) * HASH_PRIME;
+  hash = (hash ^ (unsigned long) prevSleep) * HASH_PRIME;
+  hash = hashPolicy(hash, policy);
+
+  return hash;
+}
+
+//---------------------------------------------------------------------------
+//-  Find memo of a day identical to the one starting at X[start] that was  -
+//-  entered in the same state. Returns NULL if there is none.              -
+//---------------------------------------------------------------------------
+Memo* findMemo(unsigned long hash, int start, Policy *policy, int prevSleep,
+               State *state)
+{
+  Memo*    memo;                   // Memo being compared
+  int      i;                      // Index of memo being compared
+
+  for (i = MemoBucket[hash % MEMO_BUCKETS]; i != -1; i = memo->next)
+  {
+    memo = &Memos[i];
+
+    // Compare everything, hash collisions must not change the output
+    if ((memo->hash == hash) &&
+        (samePolicy(&memo->policy, policy) == TRUE) &&
+        (memo->prevSleep == prevSleep) &&
+        (memo->entry.idleState == state->idleState) &&
+        (memo->entry.idleCount == state->idleCount) &&
+        (memo->entry.timeOutCurrent == state->timeOutCurrent) &&
+        (memcmp(memo->in, &X[start], ONEDAY) == 0))
+      return memo;
+  }
+
+  return NULL;
+}
+
+//---------------------------------------------------------------------------
+//-  Record outcome of day now at X[start], which was in[] before simulation-
+//---------------------------------------------------------------------------
+void addMemo(unsigned long hash, char *in, int start, Policy *policy,
+             int prevSleep, State *entry, State *exit)
+{
+  Memo*    memo;                   // Memo being filled in
+
+  // Table full, later distinct days are simulated every time
+  if (NumMemos >= MAX_MEMOS)
+    return;
+
+  memo = &Memos[NumMemos];
+  memo->hash      = hash;
+  memo->policy    = *policy;
+  memo->prevSleep = prevSleep;
+  memo->entry     = *entry;
+  memo->exit      = *exit;
+  memcpy(memo->in, in, ONEDAY);
+  memcpy(memo->out, &X[start], ONEDAY);
+
+  // Push onto front of its bucket
+  memo->next = MemoBucket[hash % MEMO_BUCKETS];
+  MemoBucket[hash % MEMO_BUCKETS] = NumMemos;
+  NumMemos++;
+}
+
+//---------------------------------------------------------------------------
+//-  Read checkpoint of a previous run. Returns FALSE if there is none.     -
+//---------------------------------------------------------------------------
+int readCheckpoint(char *fileName, Checkpoint *checkpoint)
+{
+  FILE     *checkpointFile;        // .prc.ckp file
+  int      count;                  // Number of values read
+
+  checkpointFile = fopen(fileName,"r");
+  if(checkpointFile == NULL)
+    return FALSE;
+
+  count = fscanf(checkpointFile,"%d,%lu,%d,%d,%d,%d,%c,%d",
+    &checkpoint->length, &checkpoint->hash,
+    &checkpoint->state.idleState, &checkpoint->state.idleCount,
+    &checkpoint->state.timeOutCurrent, &checkpoint->dayCounter,
+    &checkpoint->lastMinute, &checkpoint->pendingWakeUp);
+  fclose(checkpointFile);
+
+  if (count != 8)
+  {
+    printf("*** WARNING - Ignoring malformed checkpoint %s\n", fileName);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+//---------------------------------------------------------------------------
+//-  Save checkpoint for the next run                                       -
+//---------------------------------------------------------------------------
+void writeCheckpoint(char *fileName, Checkpoint *checkpoint)
+{
+  FILE     *checkpointFile;        // .prc.ckp file
+  char     tempFileName[265];      // Checkpoint being written
+  int      failed;                 // TRUE if writing checkpoint failed
+
+  // Write to a temporary file first so a half-written checkpoint is never
+  // read back as valid
+  strncpy(tempFileName,fileName,260);
+  strncat(tempFileName,".tmp",5);
+
+  checkpointFile = fopen(tempFileName,"w");
+  if(checkpointFile == NULL)
+  {
+    fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", tempFileName);
+    return;
+  }
+
+  fprintf(checkpointFile,"%d,%lu,%d,%d,%d,%d,%c,%d\n",
+    checkpoint->length, checkpoint->hash,
+    checkpoint->state.idleState, checkpoint->state.idleCount,
+    checkpoint->state.timeOutCurrent, checkpoint->dayCounter,
+    checkpoint->lastMinute, checkpoint->pendingWakeUp);
+  // Don't replace old checkpoint with one that failed to write
+  failed = (ferror(checkpointFile) != 0);
+  if (fclose(checkpointFile) != 0)
+    failed = TRUE;
+  if (failed == TRUE)
+  {
+    fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", tempFileName);
+    remove(tempFileName);
+    return;
+  }
+
+  // Move into place, removing the old checkpoint where rename() won't
+  if (rename(tempFileName, fileName) != 0)
+  {
+    remove(fileName);
+    if (rename(tempFileName, fileName) != 0)
+      fprintf(stdout, "*** WARNING - \tCannot write to file %s\n", fileName);
+  }
+}
+
+//---------------------------------------------------------------------------
+//-  Check .prc of a previous run is its parameter line followed by exactly -
+//-  length minutes. Returns FALSE if it is missing, short or too long.     -
+//---------------------------------------------------------------------------
+int checkOutput(char *fileName, int length)
+{
+  FILE     *outPutFile;            // .prc file
+  char     line[300];              // Parameter line of .prc file
+  long     headerLength;           // Length of parameter line
+  long     fileLength;             // Length of whole .prc file
+
+  outPutFile = fopen(fileName,"rb");
+  if(outPutFile == NULL)
+    return FALSE;
+
+  // Parameter line must be complete
+  if ((fgets(line, 300, outPutFile) == NULL) ||
+      (strchr(line, '\n') == NULL))
+  {
+    fclose(outPutFile);
+    return FALSE;
+  }
+  headerLength = ftell(outPutFile);
+
+  fseek(outPutFile, 0, SEEK_END);
+  fileLength = ftell(outPutFile);
+  fclose(outPutFile);
+
+  return (headerLength >= 0) && (fileLength == headerLength + length);
+}
+
+//---------------------------------------------------------------------------
+//-  Load X from X[length - window] on, where window is the last TAIL_WINDOW-
+//-  minutes of a previous input of length minutes. Returns TRUE if those   -
+//-  minutes still hash to hash, i.e. input only had minutes appended.      -
+//---------------------------------------------------------------------------
+int loadAppended(long dataStart, int length, unsigned long startHash,
+                 unsigned long hash)
+{
+  int      window;                 // Minutes checked before length
+
+  window = (length < TAIL_WINDOW) ? length : TAIL_WINDOW;
+  if (fseek(InFile, dataStart + length - window, SEEK_SET) != 0)
+    return FALSE;
+
+  loadX(length - window);
+
+  return (N >= length) &&
+         (hashBytes(startHash, &X[length - window], window) == hash);
+}
+
+//---------------------------------------------------------------------------
+//-  Continue hash over last TAIL_WINDOW minutes of X                       -
+//---------------------------------------------------------------------------
+unsigned long hashTail(unsigned long hash)
+{
+  int      window;                 // Minutes hashed
+
+  window = (N < TAIL_WINDOW) ? N : TAIL_WINDOW;
+
+  return hashBytes(hash, &X[N - window], window);
+}